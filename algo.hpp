@@ -0,0 +1,100 @@
+#ifndef ALGO_H
+#define ALGO_H
+
+#include <cstddef>
+#include "iterator.hpp"
+#include "function.hpp"
+
+template <typename ForwardIterator1, typename ForwardIterator2, typename T>
+inline void __iter_swap(ForwardIterator1 a, ForwardIterator2 b, T*) {
+    T tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+template <typename ForwardIterator1, typename ForwardIterator2>
+inline void iter_swap(ForwardIterator1 a, ForwardIterator2 b) {
+    __iter_swap(a, b, value_type(a));
+}
+
+const int __stl_threshold = 16;
+
+template <typename T, typename Compare>
+inline const T& __median(const T& a, const T& b, const T& c, Compare comp) {
+    if (comp(a, b)) {
+        if (comp(b, c)) return b;
+        else if (comp(a, c)) return c;
+        else return a;
+    }
+    else if (comp(a, c)) return a;
+    else if (comp(b, c)) return c;
+    else return b;
+}
+
+template <typename RandomAccessIterator, typename T, typename Compare>
+RandomAccessIterator __unguarded_partition(RandomAccessIterator first,
+                                           RandomAccessIterator last,
+                                           T pivot, Compare comp) {
+    while (true) {
+        while (comp(*first, pivot)) ++first;
+        --last;
+        while (comp(pivot, *last)) --last;
+        if (!(first < last)) return first;
+        iter_swap(first, last);
+        ++first;
+    }
+}
+
+template <typename RandomAccessIterator, typename T, typename Compare>
+void __quick_sort_loop_aux(RandomAccessIterator first,
+                           RandomAccessIterator last, T*, Compare comp) {
+    while (last - first > __stl_threshold) {
+        RandomAccessIterator cut = __unguarded_partition(
+            first, last,
+            T(__median(*first, *(first + (last - first) / 2), *(last - 1),
+                       comp)),
+            comp);
+        if (cut - first >= last - cut) {
+            __quick_sort_loop_aux(cut, last, (T*)(0), comp);
+            last = cut;
+        } else {
+            __quick_sort_loop_aux(first, cut, (T*)(0), comp);
+            first = cut;
+        }
+    }
+}
+
+template <typename RandomAccessIterator, typename T, typename Compare>
+void __insertion_sort(RandomAccessIterator first, RandomAccessIterator last,
+                      T*, Compare comp) {
+    if (first == last) return;
+    for (RandomAccessIterator i = first + 1; i != last; ++i) {
+        T value = *i;
+        RandomAccessIterator next = i;
+        while (next != first && comp(value, *(next - 1))) {
+            *next = *(next - 1);
+            --next;
+        }
+        *next = value;
+    }
+}
+
+template <typename RandomAccessIterator, typename Compare>
+inline void sort(RandomAccessIterator first, RandomAccessIterator last,
+                 Compare comp) {
+    __quick_sort_loop_aux(first, last, value_type(first), comp);
+    __insertion_sort(first, last, value_type(first), comp);
+}
+
+template <typename RandomAccessIterator, typename T>
+inline void __sort(RandomAccessIterator first, RandomAccessIterator last,
+                   T*) {
+    sort(first, last, less<T>());
+}
+
+template <typename RandomAccessIterator>
+inline void sort(RandomAccessIterator first, RandomAccessIterator last) {
+    __sort(first, last, value_type(first));
+}
+
+#endif
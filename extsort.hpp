@@ -0,0 +1,471 @@
+#ifndef EXTSORT_H
+#define EXTSORT_H
+
+#include <cstddef>
+#include <climits>
+#include <cstdio>
+#include <ctime>
+#include <stdexcept>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/time.h>
+#endif
+#include "thread.hpp"
+#include "iterator.hpp"
+#include "function.hpp"
+#include "tempbuf.hpp"
+#include "algo.hpp"
+
+// Runs are spilled as the raw bytes of T, so T must be a plain bit-copyable
+// type (no pointers to owned memory, no virtual functions).
+
+// Times are elapsed wall-clock seconds.
+struct external_sort_stats {
+    double read_seconds;
+    double sort_seconds;
+    double spill_seconds;
+    double merge_seconds;
+    std::size_t runs;
+    std::size_t merge_passes;
+    external_sort_stats(): read_seconds(0), sort_seconds(0), spill_seconds(0),
+                           merge_seconds(0), runs(0), merge_passes(0) {}
+};
+
+inline double __wall_clock() {
+#if defined(__unix__) || defined(__APPLE__)
+    timeval now;
+    gettimeofday(&now, 0);
+    return now.tv_sec + now.tv_usec * 1e-6;
+#else
+    return double(std::time(0));
+#endif
+}
+
+const std::size_t __external_sort_min_slice = 1 << 12;
+const std::size_t __external_sort_min_read_ahead = 1 << 16;
+
+template <typename T>
+class __scoped_array {
+protected:
+    T* array;
+    __scoped_array(const __scoped_array<T>&);
+    void operator=(const __scoped_array<T>&);
+public:
+    __scoped_array(std::size_t n): array(new T[n]) {}
+    ~__scoped_array() { delete[] array; }
+    T* begin() const { return array; }
+};
+
+template <typename T>
+class __temporary_buffer {
+protected:
+    pair<T*, std::ptrdiff_t> buffer;
+    __temporary_buffer(const __temporary_buffer<T>&);
+    void operator=(const __temporary_buffer<T>&);
+public:
+    __temporary_buffer(std::ptrdiff_t n): buffer(get_temporary_buffer<T>(n)) {}
+    ~__temporary_buffer() { return_temporary_buffer(buffer.first); }
+    T* begin() const { return buffer.first; }
+};
+
+// All runs of one merge level share a single temporary file, so the number
+// of open files does not grow with the input; run i occupies elements
+// [bounds[i], bounds[i + 1]). Reads move the file position with relative
+// seeks of at most LONG_MAX bytes, so offsets past 2 GiB stay exact where
+// long is 32 bits.
+template <typename T>
+class __run_file {
+protected:
+    std::FILE* file;
+    std::size_t* bounds;
+    std::size_t count;
+    std::size_t capacity;
+    std::size_t length;
+    std::size_t position;
+    __mutex mutex;
+    __run_file(const __run_file<T>&);
+    void operator=(const __run_file<T>&);
+public:
+    __run_file(): file(0), bounds(new std::size_t[16]), count(0),
+                  capacity(15), length(0), position(0) {
+        bounds[0] = 0;
+    }
+    ~__run_file() {
+        if (file) std::fclose(file);
+        delete[] bounds;
+    }
+    std::size_t size() const { return count; }
+    std::size_t run_begin(std::size_t i) const { return bounds[i]; }
+    std::size_t run_end(std::size_t i) const { return bounds[i + 1]; }
+    void write(const T* buffer, std::size_t n) {
+        if (!file && !(file = std::tmpfile()))
+            throw std::runtime_error("external_sort: cannot create temporary file");
+        if (std::fwrite(buffer, sizeof(T), n, file) != n)
+            throw std::runtime_error("external_sort: cannot write temporary file");
+        length += n;
+        position = length;
+    }
+    void end_run() {
+        if (count == capacity) {
+            std::size_t* tmp = new std::size_t[2 * capacity + 1];
+            for (std::size_t i = 0; i <= count; ++i) tmp[i] = bounds[i];
+            delete[] bounds;
+            bounds = tmp;
+            capacity *= 2;
+        }
+        bounds[++count] = length;
+    }
+    bool seek(std::size_t offset) {
+        const std::size_t max_step = LONG_MAX / sizeof(T);
+        if (position == offset) return std::fseek(file, 0, SEEK_CUR) == 0;
+        while (position != offset) {
+            std::size_t step = offset > position ? offset - position
+                                                 : position - offset;
+            if (step > max_step) step = max_step;
+            long bytes = long(step * sizeof(T));
+            if (std::fseek(file, offset > position ? bytes : -bytes,
+                           SEEK_CUR) != 0)
+                return false;
+            position = offset > position ? position + step : position - step;
+        }
+        return true;
+    }
+    bool read(std::size_t offset, T* buffer, std::size_t n) {
+        __lock lock(mutex);
+        if (!seek(offset)) return false;
+        std::size_t got = std::fread(buffer, sizeof(T), n, file);
+        position += got;
+        return got == n && !std::ferror(file);
+    }
+    void swap(__run_file<T>& x) {
+        std::FILE* f = file; file = x.file; x.file = f;
+        std::size_t* b = bounds; bounds = x.bounds; x.bounds = b;
+        std::size_t n = count; count = x.count; x.count = n;
+        n = capacity; capacity = x.capacity; x.capacity = n;
+        n = length; length = x.length; x.length = n;
+        n = position; position = x.position; x.position = n;
+    }
+};
+
+template <typename T>
+struct __run_fetch {
+    __run_file<T>* file;
+    std::size_t offset;
+    T* buffer;
+    std::size_t n;
+    bool ok;
+    void operator()() { ok = file->read(offset, buffer, n); }
+};
+
+// Double-buffered: while the merge consumes one half of the reader's slice,
+// the other half is filled in the background. Halves smaller than
+// __external_sort_min_read_ahead bytes are filled synchronously, since a
+// thread start would cost more than the read.
+template <typename T>
+class __run_reader {
+protected:
+    __run_file<T>* file;
+    std::size_t offset;
+    std::size_t end;
+    T* current;
+    T* next;
+    std::size_t capacity;
+    std::size_t size;
+    std::size_t pos;
+    std::size_t requested;
+    __run_fetch<T> fetch;
+    __async<__run_fetch<T> > pending;
+    void request() {
+        requested = end - offset < capacity ? end - offset : capacity;
+        if (requested == 0) return;
+        fetch.file = file;
+        fetch.offset = offset;
+        fetch.buffer = next;
+        fetch.n = requested;
+        fetch.ok = false;
+        offset += requested;
+        if (capacity * sizeof(T) >= __external_sort_min_read_ahead)
+            pending.start(&fetch);
+        else
+            fetch();
+    }
+    void take() {
+        pending.wait();
+        if (requested && !fetch.ok)
+            throw std::runtime_error("external_sort: cannot read temporary file");
+        T* tmp = current;
+        current = next;
+        next = tmp;
+        size = requested;
+        pos = 0;
+        request();
+    }
+public:
+    typedef T value_type;
+    __run_reader(): file(0), offset(0), end(0), current(0), next(0),
+                    capacity(0), size(0), pos(0), requested(0) {}
+    void open(__run_file<T>* f, std::size_t run, T* buffer, std::size_t n) {
+        file = f;
+        offset = f->run_begin(run);
+        end = f->run_end(run);
+        capacity = n / 2;
+        current = buffer;
+        next = buffer + capacity;
+        request();
+        take();
+    }
+    bool empty() const { return pos == size; }
+    const T& front() const { return current[pos]; }
+    void pop() {
+        if (++pos == size) take();
+    }
+};
+
+template <typename T>
+struct __run_slice {
+    typedef T value_type;
+    const T* first;
+    const T* last;
+    bool empty() const { return first == last; }
+    const T& front() const { return *first; }
+    void pop() { ++first; }
+};
+
+template <typename T>
+class __run_writer: public output_iterator {
+protected:
+    __run_file<T>* file;
+    T* buffer;
+    std::size_t capacity;
+    std::size_t size;
+public:
+    __run_writer(__run_file<T>* f, T* b, std::size_t n):
+        file(f), buffer(b), capacity(n), size(0) {}
+    __run_writer<T>& operator=(const T& value) {
+        buffer[size++] = value;
+        if (size == capacity) flush();
+        return *this;
+    }
+    __run_writer<T>& operator*() { return *this; }
+    __run_writer<T>& operator++() { return *this; }
+    __run_writer<T>& operator++(int) { return *this; }
+    void flush() {
+        file->write(buffer, size);
+        size = 0;
+    }
+};
+
+// Internal node i holds the loser of the match played there; tree[0] holds
+// the overall winner. Exhausted sources lose every match.
+template <typename Source, typename Compare>
+class __loser_tree {
+protected:
+    Source* sources;
+    std::size_t* tree;
+    std::size_t k;
+    Compare comp;
+    __loser_tree(const __loser_tree<Source, Compare>&);
+    void operator=(const __loser_tree<Source, Compare>&);
+    bool beats(std::size_t a, std::size_t b) const {
+        if (sources[a].empty()) return false;
+        if (sources[b].empty()) return true;
+        return comp(sources[a].front(), sources[b].front()) ? true : false;
+    }
+    std::size_t child_winner(const std::size_t* winner, std::size_t node) {
+        return node < k ? winner[node] : node - k;
+    }
+    void build() {
+        if (k == 1) {
+            tree[0] = 0;
+            return;
+        }
+        __scoped_array<std::size_t> winner(k);
+        for (std::size_t node = k - 1; node > 0; --node) {
+            std::size_t left = child_winner(winner.begin(), 2 * node);
+            std::size_t right = child_winner(winner.begin(), 2 * node + 1);
+            if (beats(left, right)) {
+                tree[node] = right;
+                winner.begin()[node] = left;
+            } else {
+                tree[node] = left;
+                winner.begin()[node] = right;
+            }
+        }
+        tree[0] = winner.begin()[1];
+    }
+public:
+    __loser_tree(Source* s, std::size_t n, Compare c):
+        sources(s), tree(new std::size_t[n]), k(n), comp(c) {
+        build();
+    }
+    ~__loser_tree() { delete[] tree; }
+    bool empty() const { return sources[tree[0]].empty(); }
+    const typename Source::value_type& top() const {
+        return sources[tree[0]].front();
+    }
+    void pop() {
+        std::size_t winner = tree[0];
+        sources[winner].pop();
+        for (std::size_t node = (winner + k) / 2; node > 0; node /= 2)
+            if (beats(tree[node], winner)) {
+                std::size_t tmp = tree[node];
+                tree[node] = winner;
+                winner = tmp;
+            }
+        tree[0] = winner;
+    }
+};
+
+template <typename Source, typename OutputIterator, typename Compare>
+OutputIterator __merge_sources(Source* sources, std::size_t n,
+                               OutputIterator result, Compare comp) {
+    __loser_tree<Source, Compare> tree(sources, n, comp);
+    while (!tree.empty()) {
+        *result = tree.top();
+        ++result;
+        tree.pop();
+    }
+    return result;
+}
+
+template <typename T, typename OutputIterator, typename Compare>
+OutputIterator __merge_runs(__run_file<T>& file, std::size_t first,
+                            std::size_t n, T* buffer, std::size_t chunk,
+                            OutputIterator result, Compare comp) {
+    __scoped_array<__run_reader<T> > readers(n);
+    for (std::size_t i = 0; i < n; ++i)
+        readers.begin()[i].open(&file, first + i, buffer + i * chunk, chunk);
+    return __merge_sources(readers.begin(), n, result, comp);
+}
+
+template <typename T, typename Compare>
+struct __sort_task {
+    T* first;
+    T* last;
+    Compare comp;
+    __sort_task(T* f, T* l, Compare c): first(f), last(l), comp(c) {}
+    void operator()() { sort(first, last, comp); }
+};
+
+// Each filled buffer is cut into one slice per thread and the slices are
+// sorted in parallel, then merged into a single run through a writer chunk
+// reserved at the end of the budget. The fan-in is lowered to what the
+// budget can hold; only a budget below the 2-way minimum is raised.
+template <typename InputIterator, typename OutputIterator, typename T,
+          typename Compare>
+OutputIterator __external_sort(InputIterator first, InputIterator last,
+                               OutputIterator result, Compare comp,
+                               std::size_t memory, std::size_t fan_in,
+                               external_sort_stats* stats, T*) {
+    external_sort_stats local;
+    std::size_t capacity = memory / sizeof(T);
+    if (capacity < 6) capacity = 6;
+    if (fan_in > capacity / 2 - 1) fan_in = capacity / 2 - 1;
+    if (fan_in < 2) fan_in = 2;
+    std::size_t chunk = capacity / (fan_in + 1);
+    std::size_t run_capacity = capacity - chunk;
+    __temporary_buffer<T> buffer(capacity);
+    __run_file<T> runs;
+
+    while (first != last) {
+        double start = __wall_clock();
+        T* end = buffer.begin();
+        T* limit = end + run_capacity;
+        while (end != limit && first != last) {
+            *end++ = *first;
+            ++first;
+        }
+        local.read_seconds += __wall_clock() - start;
+
+        start = __wall_clock();
+        std::size_t n = end - buffer.begin();
+        std::size_t slices = __thread_count();
+        if (slices > n / __external_sort_min_slice)
+            slices = n / __external_sort_min_slice;
+        if (slices == 0) slices = 1;
+        std::size_t step = n / slices;
+        __task_group<__sort_task<T, Compare> > sorts(slices);
+        for (std::size_t i = 0; i < slices; ++i)
+            sorts.push(__sort_task<T, Compare>(
+                buffer.begin() + i * step,
+                i + 1 < slices ? buffer.begin() + (i + 1) * step : end, comp));
+        sorts.run();
+        local.sort_seconds += __wall_clock() - start;
+        ++local.runs;
+
+        __scoped_array<__run_slice<T> > sources(slices);
+        for (std::size_t i = 0; i < slices; ++i) {
+            sources.begin()[i].first = sorts[i].first;
+            sources.begin()[i].last = sorts[i].last;
+        }
+
+        if (runs.size() == 0 && !(first != last)) {
+            start = __wall_clock();
+            result = __merge_sources(sources.begin(), slices, result, comp);
+            local.merge_seconds += __wall_clock() - start;
+            if (stats) *stats = local;
+            return result;
+        }
+
+        start = __wall_clock();
+        if (slices == 1) {
+            runs.write(buffer.begin(), n);
+        } else {
+            __run_writer<T> out(&runs, buffer.begin() + run_capacity, chunk);
+            __merge_sources(sources.begin(), slices, out, comp).flush();
+        }
+        runs.end_run();
+        local.spill_seconds += __wall_clock() - start;
+    }
+
+    if (runs.size() != 0) {
+        double start = __wall_clock();
+        while (runs.size() > fan_in) {
+            __run_file<T> next;
+            for (std::size_t i = 0; i < runs.size(); i += fan_in) {
+                std::size_t n = runs.size() - i;
+                if (n > fan_in) n = fan_in;
+                __run_writer<T> out(&next, buffer.begin() + n * chunk, chunk);
+                __merge_runs(runs, i, n, buffer.begin(), chunk, out,
+                             comp).flush();
+                next.end_run();
+            }
+            runs.swap(next);
+            ++local.merge_passes;
+        }
+        result = __merge_runs(runs, 0, runs.size(), buffer.begin(), chunk,
+                              result, comp);
+        ++local.merge_passes;
+        local.merge_seconds += __wall_clock() - start;
+    }
+    if (stats) *stats = local;
+    return result;
+}
+
+template <typename InputIterator, typename OutputIterator, typename Compare>
+inline OutputIterator external_sort(InputIterator first, InputIterator last,
+                                    OutputIterator result, Compare comp,
+                                    std::size_t memory, std::size_t fan_in,
+                                    external_sort_stats* stats = 0) {
+    return __external_sort(first, last, result, comp, memory, fan_in, stats,
+                           value_type(first));
+}
+
+template <typename InputIterator, typename OutputIterator, typename T>
+inline OutputIterator __external_sort(InputIterator first, InputIterator last,
+                                      OutputIterator result,
+                                      std::size_t memory, std::size_t fan_in,
+                                      external_sort_stats* stats, T*) {
+    return __external_sort(first, last, result, less<T>(), memory, fan_in,
+                           stats, (T*)(0));
+}
+
+template <typename InputIterator, typename OutputIterator>
+inline OutputIterator external_sort(InputIterator first, InputIterator last,
+                                    OutputIterator result, std::size_t memory,
+                                    std::size_t fan_in,
+                                    external_sort_stats* stats = 0) {
+    return __external_sort(first, last, result, memory, fan_in, stats,
+                           value_type(first));
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <cstddef>
+#include <new>
 #include "bool.hpp"
 #include "function.hpp"
 
@@ -287,12 +288,23 @@ operator+(Distance n,
     (x.current - n);
 }
 
+template <class T1, class T2>
+inline void construct(T1* p, const T2& value) {
+    new (p) T1(value);
+}
+
+template <class T>
+inline void destroy(T* pointer) {
+    pointer->~T();
+}
+
 template <class OutputIterator, class T>
 class raw_storage_iterator: public output_iterator {
 protected:
     OutputIterator iter;
 public:
     raw_storage_iterator(OutputIterator x): iter(x) {}
+    OutputIterator base() { return iter; }
     raw_storage_iterator<OutputIterator, T>& operator*() { return *this; }
     raw_storage_iterator<OutputIterator, T>& operator=(const T& element) {
         construct(iter, element);
@@ -309,8 +321,16 @@ public:
     }
 };
 
+template <class T, class Distance> class istream_iterator;
+
+template <class T, class Distance>
+bool operator==(const istream_iterator<T, Distance>& x,
+                const istream_iterator<T, Distance>& y);
+
 template <class T, class Distance>
 class istream_iterator: public input_iterator<T, Distance> {
+    friend bool operator== <>(const istream_iterator<T, Distance>& x,
+                              const istream_iterator<T, Distance>& y);
 protected:
     std::istream* stream;
     T value;
@@ -338,8 +358,8 @@ public:
 template <class T, class Distance>
 bool operator==(const istream_iterator<T, Distance>& x,
                 const istream_iterator<T, Distance>& y) {
-    return x.stream == y.stream && x.end_marker == y.end_marker ||
-    x.end_marker == false && y.end_marker == false;
+    return (x.stream == y.stream && x.end_marker == y.end_marker) ||
+    (x.end_marker == false && y.end_marker == false);
 }
 
 template <class T>
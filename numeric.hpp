@@ -0,0 +1,531 @@
+#ifndef NUMERIC_H
+#define NUMERIC_H
+
+#include <cstddef>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#include "thread.hpp"
+#include "iterator.hpp"
+#include "function.hpp"
+
+template <typename InputIterator, typename OutputIterator, typename T,
+          typename BinaryOperation>
+OutputIterator __partial_sum(InputIterator first, InputIterator last,
+                             OutputIterator result, T*,
+                             BinaryOperation binary_op) {
+    T value = *first;
+    while (++first != last) {
+        value = binary_op(value, *first);
+        *++result = value;
+    }
+    return ++result;
+}
+
+template <typename InputIterator, typename OutputIterator,
+          typename BinaryOperation>
+OutputIterator partial_sum(InputIterator first, InputIterator last,
+                           OutputIterator result, BinaryOperation binary_op) {
+    if (first == last) return result;
+    *result = *first;
+    return __partial_sum(first, last, result, value_type(first), binary_op);
+}
+
+template <typename InputIterator, typename OutputIterator, typename T>
+inline OutputIterator __partial_sum(InputIterator first, InputIterator last,
+                                    OutputIterator result, T*) {
+    return partial_sum(first, last, result, plus<T>());
+}
+
+template <typename InputIterator, typename OutputIterator>
+inline OutputIterator partial_sum(InputIterator first, InputIterator last,
+                                  OutputIterator result) {
+    return __partial_sum(first, last, result, value_type(first));
+}
+
+// The contiguous scan and reduce kernels below regroup (and, in the vector
+// reduce, reorder) the operations, so inclusive_scan and exclusive_scan
+// require binary_op to be associative. Floating-point results may differ
+// from the strict left-to-right order of partial_sum. They serve pointer
+// destinations and, for int, float and double, raw_storage_iterator<T*, T>
+// into uninitialized memory; other raw_storage_iterator destinations take
+// the serial generic path.
+template <typename T, typename BinaryOperation>
+T* __inclusive_scan_serial(const T* first, const T* last, T* result,
+                           T carry, BinaryOperation binary_op) {
+    for (; first != last; ++first, ++result) {
+        carry = binary_op(carry, *first);
+        *result = carry;
+    }
+    return result;
+}
+
+template <typename T, typename BinaryOperation>
+T* __exclusive_scan_serial(const T* first, const T* last, T* result,
+                           T carry, BinaryOperation binary_op) {
+    for (; first != last; ++first, ++result) {
+        T value = binary_op(carry, *first);
+        *result = carry;
+        carry = value;
+    }
+    return result;
+}
+
+template <typename T, typename BinaryOperation>
+T __reduce_serial(const T* first, const T* last, T value,
+                  BinaryOperation binary_op) {
+    for (; first != last; ++first) value = binary_op(value, *first);
+    return value;
+}
+
+template <typename T, typename BinaryOperation>
+inline T* __inclusive_scan_kernel(const T* first, const T* last, T* result,
+                                  T carry, BinaryOperation binary_op) {
+    return __inclusive_scan_serial(first, last, result, carry, binary_op);
+}
+
+template <typename T, typename BinaryOperation>
+inline T* __exclusive_scan_kernel(const T* first, const T* last, T* result,
+                                  T carry, BinaryOperation binary_op) {
+    return __exclusive_scan_serial(first, last, result, carry, binary_op);
+}
+
+template <typename T, typename BinaryOperation>
+inline T __reduce_kernel(const T* first, const T* last, T value,
+                         BinaryOperation binary_op) {
+    return __reduce_serial(first, last, value, binary_op);
+}
+
+#ifdef __SSE2__
+template <typename Policy, typename BinaryOperation>
+typename Policy::value_type*
+__simd_inclusive_scan(const typename Policy::value_type* first,
+                      const typename Policy::value_type* last,
+                      typename Policy::value_type* result,
+                      typename Policy::value_type carry,
+                      BinaryOperation binary_op) {
+    typedef typename Policy::vector vector;
+    vector c = Policy::broadcast(carry);
+    for (; last - first >= 2 * Policy::width;
+         first += 2 * Policy::width, result += 2 * Policy::width) {
+        vector x0 = Policy::prefix(Policy::load(first));
+        vector x1 = Policy::prefix(Policy::load(first + Policy::width));
+        x1 = Policy::apply(Policy::last(x0), x1);
+        Policy::store(result, Policy::apply(c, x0));
+        c = Policy::apply(c, x1);
+        Policy::store(result + Policy::width, c);
+        c = Policy::last(c);
+    }
+    return __inclusive_scan_serial(first, last, result, Policy::scalar(c),
+                                   binary_op);
+}
+
+template <typename Policy, typename BinaryOperation>
+typename Policy::value_type*
+__simd_exclusive_scan(const typename Policy::value_type* first,
+                      const typename Policy::value_type* last,
+                      typename Policy::value_type* result,
+                      typename Policy::value_type carry,
+                      BinaryOperation binary_op) {
+    typedef typename Policy::vector vector;
+    vector c = Policy::broadcast(carry);
+    for (; last - first >= 2 * Policy::width;
+         first += 2 * Policy::width, result += 2 * Policy::width) {
+        vector x0 = Policy::prefix(Policy::load(first));
+        vector x1 = Policy::prefix(Policy::load(first + Policy::width));
+        x1 = Policy::apply(Policy::last(x0), x1);
+        x0 = Policy::apply(c, x0);
+        Policy::store(result, Policy::shift_in(x0, c));
+        x1 = Policy::apply(c, x1);
+        Policy::store(result + Policy::width,
+                      Policy::shift_in(x1, Policy::last(x0)));
+        c = Policy::last(x1);
+    }
+    return __exclusive_scan_serial(first, last, result, Policy::scalar(c),
+                                   binary_op);
+}
+
+template <typename Policy, typename BinaryOperation>
+typename Policy::value_type
+__simd_reduce(const typename Policy::value_type* first,
+              const typename Policy::value_type* last,
+              typename Policy::value_type value, BinaryOperation binary_op) {
+    if (last - first < 2 * Policy::width)
+        return __reduce_serial(first, last, value, binary_op);
+    typename Policy::vector acc = Policy::load(first);
+    for (first += Policy::width; last - first >= Policy::width;
+         first += Policy::width)
+        acc = Policy::apply(acc, Policy::load(first));
+    typename Policy::value_type lanes[Policy::width];
+    Policy::store(lanes, acc);
+    value = __reduce_serial((const typename Policy::value_type*)lanes,
+                            lanes + Policy::width, value, binary_op);
+    return __reduce_serial(first, last, value, binary_op);
+}
+
+struct __sse_epi32 {
+    typedef int value_type;
+    typedef __m128i vector;
+    enum { width = 4 };
+    static vector load(const int* p) {
+        return _mm_loadu_si128((const __m128i*)p);
+    }
+    static void store(int* p, vector x) { _mm_storeu_si128((__m128i*)p, x); }
+    static vector broadcast(int x) { return _mm_set1_epi32(x); }
+    static vector last(vector x) { return _mm_shuffle_epi32(x, 0xFF); }
+    static vector shift_in(vector x, vector c) {
+        return _mm_or_si128(_mm_slli_si128(x, 4), _mm_srli_si128(c, 12));
+    }
+    static int scalar(vector x) { return _mm_cvtsi128_si32(x); }
+};
+
+struct __sse_plus_epi32: __sse_epi32 {
+    static vector apply(vector a, vector b) { return _mm_add_epi32(a, b); }
+    static vector prefix(vector x) {
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        return _mm_add_epi32(x, _mm_slli_si128(x, 8));
+    }
+};
+
+#ifdef __SSE4_1__
+struct __sse_times_epi32: __sse_epi32 {
+    static vector apply(vector a, vector b) { return _mm_mullo_epi32(a, b); }
+    static vector prefix(vector x) {
+        x = _mm_mullo_epi32(x, _mm_or_si128(_mm_slli_si128(x, 4),
+                                            _mm_setr_epi32(1, 0, 0, 0)));
+        return _mm_mullo_epi32(x, _mm_or_si128(_mm_slli_si128(x, 8),
+                                               _mm_setr_epi32(1, 1, 0, 0)));
+    }
+};
+#endif
+
+struct __sse_ps {
+    typedef float value_type;
+    typedef __m128 vector;
+    enum { width = 4 };
+    static vector load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, vector x) { _mm_storeu_ps(p, x); }
+    static vector broadcast(float x) { return _mm_set1_ps(x); }
+    static vector last(vector x) { return _mm_shuffle_ps(x, x, 0xFF); }
+    static vector shift(vector x, int bytes) {
+        return bytes == 4
+            ? _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4))
+            : _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8));
+    }
+    static vector shift_in(vector x, vector c) {
+        return _mm_move_ss(shift(x, 4), c);
+    }
+    static float scalar(vector x) { return _mm_cvtss_f32(x); }
+};
+
+struct __sse_plus_ps: __sse_ps {
+    static vector apply(vector a, vector b) { return _mm_add_ps(a, b); }
+    static vector prefix(vector x) {
+        x = _mm_add_ps(x, shift(x, 4));
+        return _mm_add_ps(x, shift(x, 8));
+    }
+};
+
+struct __sse_times_ps: __sse_ps {
+    static vector apply(vector a, vector b) { return _mm_mul_ps(a, b); }
+    static vector prefix(vector x) {
+        x = _mm_mul_ps(x, _mm_or_ps(shift(x, 4),
+                                    _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f)));
+        return _mm_mul_ps(x, _mm_or_ps(shift(x, 8),
+                                       _mm_setr_ps(1.0f, 1.0f, 0.0f, 0.0f)));
+    }
+};
+
+struct __sse_pd {
+    typedef double value_type;
+    typedef __m128d vector;
+    enum { width = 2 };
+    static vector load(const double* p) { return _mm_loadu_pd(p); }
+    static void store(double* p, vector x) { _mm_storeu_pd(p, x); }
+    static vector broadcast(double x) { return _mm_set1_pd(x); }
+    static vector last(vector x) { return _mm_unpackhi_pd(x, x); }
+    static vector shift(vector x) {
+        return _mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(x), 8));
+    }
+    static vector shift_in(vector x, vector c) {
+        return _mm_shuffle_pd(c, x, 0);
+    }
+    static double scalar(vector x) { return _mm_cvtsd_f64(x); }
+};
+
+struct __sse_plus_pd: __sse_pd {
+    static vector apply(vector a, vector b) { return _mm_add_pd(a, b); }
+    static vector prefix(vector x) { return _mm_add_pd(x, shift(x)); }
+};
+
+struct __sse_times_pd: __sse_pd {
+    static vector apply(vector a, vector b) { return _mm_mul_pd(a, b); }
+    static vector prefix(vector x) {
+        return _mm_mul_pd(x, _mm_or_pd(shift(x), _mm_setr_pd(1.0, 0.0)));
+    }
+};
+
+#define __STL_SIMD_SCAN(T, Operation, Policy)                               \
+inline T* __inclusive_scan_kernel(const T* first, const T* last, T* result, \
+                                  T carry, Operation<T> binary_op) {        \
+    return __simd_inclusive_scan<Policy>(first, last, result, carry,        \
+                                         binary_op);                        \
+}                                                                           \
+inline T* __exclusive_scan_kernel(const T* first, const T* last, T* result, \
+                                  T carry, Operation<T> binary_op) {        \
+    return __simd_exclusive_scan<Policy>(first, last, result, carry,        \
+                                         binary_op);                        \
+}                                                                           \
+inline T __reduce_kernel(const T* first, const T* last, T value,            \
+                         Operation<T> binary_op) {                          \
+    return __simd_reduce<Policy>(first, last, value, binary_op);            \
+}
+
+__STL_SIMD_SCAN(int, plus, __sse_plus_epi32)
+#ifdef __SSE4_1__
+__STL_SIMD_SCAN(int, times, __sse_times_epi32)
+#endif
+__STL_SIMD_SCAN(float, plus, __sse_plus_ps)
+__STL_SIMD_SCAN(float, times, __sse_times_ps)
+__STL_SIMD_SCAN(double, plus, __sse_plus_pd)
+__STL_SIMD_SCAN(double, times, __sse_times_pd)
+
+#undef __STL_SIMD_SCAN
+#endif
+
+template <typename T, typename BinaryOperation>
+struct __reduce_task {
+    const T* first;
+    const T* last;
+    T value;
+    BinaryOperation binary_op;
+    __reduce_task(const T* f, const T* l, const T& v, BinaryOperation op):
+        first(f), last(l), value(v), binary_op(op) {}
+    void operator()() {
+        value = __reduce_kernel(first, last, value, binary_op);
+    }
+};
+
+template <typename T, typename BinaryOperation>
+struct __scan_task {
+    const T* first;
+    const T* last;
+    T* result;
+    T carry;
+    BinaryOperation binary_op;
+    int exclusive;
+    __scan_task(const T* f, const T* l, T* r, const T& c, BinaryOperation op,
+                int e): first(f), last(l), result(r), carry(c), binary_op(op),
+                        exclusive(e) {}
+    void operator()() {
+        if (exclusive)
+            __exclusive_scan_kernel(first, last, result, carry, binary_op);
+        else
+            __inclusive_scan_kernel(first, last, result, carry, binary_op);
+    }
+};
+
+const std::ptrdiff_t __scan_block_size = 1 << 16;
+
+// Two-pass block scan: reduce every block but the last in parallel, chain
+// the block totals serially, then scan every block from its carry in
+// parallel. The input is only read by the first pass, so in-place is safe.
+template <typename T, typename BinaryOperation>
+T* __parallel_scan(const T* first, const T* last, T* result, T carry,
+                   BinaryOperation binary_op, int exclusive,
+                   std::size_t blocks) {
+    std::ptrdiff_t n = last - first;
+    std::ptrdiff_t step = n / blocks;
+    __task_group<__reduce_task<T, BinaryOperation> > reduce(blocks - 1);
+    for (std::size_t i = 0; i + 1 < blocks; ++i)
+        reduce.push(__reduce_task<T, BinaryOperation>(
+            first + i * step + 1, first + (i + 1) * step,
+            first[i * step], binary_op));
+    reduce.run();
+
+    __task_group<__scan_task<T, BinaryOperation> > scan(blocks);
+    for (std::size_t i = 0; i < blocks; ++i) {
+        const T* block_last = i + 1 < blocks ? first + (i + 1) * step : last;
+        scan.push(__scan_task<T, BinaryOperation>(
+            first + i * step, block_last, result + i * step, carry,
+            binary_op, exclusive));
+        if (i + 1 < blocks) carry = binary_op(carry, reduce[i].value);
+    }
+    scan.run();
+    return result + n;
+}
+
+template <typename T, typename BinaryOperation>
+T* __scan_contiguous(const T* first, const T* last, T* result, T carry,
+                     BinaryOperation binary_op, int exclusive) {
+#ifdef __STL_PTHREADS
+    std::ptrdiff_t n = last - first;
+    std::size_t blocks = __thread_count();
+    if (std::ptrdiff_t(blocks) > n / __scan_block_size)
+        blocks = n / __scan_block_size;
+    if (blocks >= 2)
+        return __parallel_scan(first, last, result, carry, binary_op,
+                               exclusive, blocks);
+#endif
+    return exclusive
+        ? __exclusive_scan_kernel(first, last, result, carry, binary_op)
+        : __inclusive_scan_kernel(first, last, result, carry, binary_op);
+}
+
+template <typename InputIterator, typename OutputIterator,
+          typename BinaryOperation>
+inline OutputIterator inclusive_scan(InputIterator first, InputIterator last,
+                                     OutputIterator result,
+                                     BinaryOperation binary_op) {
+    return partial_sum(first, last, result, binary_op);
+}
+
+template <typename T, typename BinaryOperation>
+inline T* __inclusive_scan_contiguous(const T* first, const T* last,
+                                      T* result, BinaryOperation binary_op) {
+    if (first == last) return result;
+    T carry = *first;
+    *result = carry;
+    return __scan_contiguous(first + 1, last, result + 1, carry, binary_op, 0);
+}
+
+template <typename T, typename BinaryOperation>
+inline T* inclusive_scan(T* first, T* last, T* result,
+                         BinaryOperation binary_op) {
+    return __inclusive_scan_contiguous((const T*)first, (const T*)last, result,
+                                       binary_op);
+}
+
+template <typename T, typename BinaryOperation>
+inline T* inclusive_scan(const T* first, const T* last, T* result,
+                         BinaryOperation binary_op) {
+    return __inclusive_scan_contiguous(first, last, result, binary_op);
+}
+
+template <typename InputIterator, typename OutputIterator, typename T>
+inline OutputIterator __inclusive_scan(InputIterator first, InputIterator last,
+                                       OutputIterator result, T*) {
+    return inclusive_scan(first, last, result, plus<T>());
+}
+
+template <typename InputIterator, typename OutputIterator>
+inline OutputIterator inclusive_scan(InputIterator first, InputIterator last,
+                                     OutputIterator result) {
+    return __inclusive_scan(first, last, result, value_type(first));
+}
+
+template <typename InputIterator, typename OutputIterator, typename T,
+          typename BinaryOperation>
+OutputIterator exclusive_scan(InputIterator first, InputIterator last,
+                              OutputIterator result, T init,
+                              BinaryOperation binary_op) {
+    while (first != last) {
+        T value = binary_op(init, *first);
+        *result = init;
+        init = value;
+        ++first;
+        ++result;
+    }
+    return result;
+}
+
+template <typename T, typename BinaryOperation>
+inline T* exclusive_scan(T* first, T* last, T* result, T init,
+                         BinaryOperation binary_op) {
+    return __scan_contiguous((const T*)first, (const T*)last, result, init,
+                             binary_op, 1);
+}
+
+template <typename T, typename BinaryOperation>
+inline T* exclusive_scan(const T* first, const T* last, T* result, T init,
+                         BinaryOperation binary_op) {
+    return __scan_contiguous(first, last, result, init, binary_op, 1);
+}
+
+template <typename InputIterator, typename OutputIterator, typename T>
+inline OutputIterator exclusive_scan(InputIterator first, InputIterator last,
+                                     OutputIterator result, T init) {
+    return exclusive_scan(first, last, result, init, plus<T>());
+}
+
+#define __STL_RAW_STORAGE_SCAN(T)                                           \
+template <typename BinaryOperation>                                         \
+inline raw_storage_iterator<T*, T>                                          \
+inclusive_scan(const T* first, const T* last,                               \
+               raw_storage_iterator<T*, T> result,                          \
+               BinaryOperation binary_op) {                                 \
+    return raw_storage_iterator<T*, T>(                                     \
+        __inclusive_scan_contiguous(first, last, result.base(), binary_op)); \
+}                                                                           \
+template <typename BinaryOperation>                                         \
+inline raw_storage_iterator<T*, T>                                          \
+inclusive_scan(T* first, T* last, raw_storage_iterator<T*, T> result,       \
+               BinaryOperation binary_op) {                                 \
+    return inclusive_scan((const T*)first, (const T*)last, result,          \
+                          binary_op);                                       \
+}                                                                           \
+template <typename BinaryOperation>                                         \
+inline raw_storage_iterator<T*, T>                                          \
+exclusive_scan(const T* first, const T* last,                               \
+               raw_storage_iterator<T*, T> result, T init,                  \
+               BinaryOperation binary_op) {                                 \
+    return raw_storage_iterator<T*, T>(                                     \
+        __scan_contiguous(first, last, result.base(), init, binary_op, 1)); \
+}                                                                           \
+template <typename BinaryOperation>                                         \
+inline raw_storage_iterator<T*, T>                                          \
+exclusive_scan(T* first, T* last, raw_storage_iterator<T*, T> result,       \
+               T init, BinaryOperation binary_op) {                         \
+    return exclusive_scan((const T*)first, (const T*)last, result, init,    \
+                          binary_op);                                       \
+}
+
+__STL_RAW_STORAGE_SCAN(int)
+__STL_RAW_STORAGE_SCAN(float)
+__STL_RAW_STORAGE_SCAN(double)
+
+#undef __STL_RAW_STORAGE_SCAN
+
+template <typename InputIterator, typename OutputIterator, typename T,
+          typename BinaryOperation>
+OutputIterator __adjacent_difference(InputIterator first, InputIterator last,
+                                     OutputIterator result, T*,
+                                     BinaryOperation binary_op) {
+    T value = *first;
+    while (++first != last) {
+        T tmp = *first;
+        *++result = binary_op(tmp, value);
+        value = tmp;
+    }
+    return ++result;
+}
+
+template <typename InputIterator, typename OutputIterator,
+          typename BinaryOperation>
+OutputIterator adjacent_difference(InputIterator first, InputIterator last,
+                                   OutputIterator result,
+                                   BinaryOperation binary_op) {
+    if (first == last) return result;
+    *result = *first;
+    return __adjacent_difference(first, last, result, value_type(first),
+                                 binary_op);
+}
+
+template <typename InputIterator, typename OutputIterator, typename T>
+inline OutputIterator __adjacent_difference(InputIterator first,
+                                            InputIterator last,
+                                            OutputIterator result, T*) {
+    return adjacent_difference(first, last, result, minus<T>());
+}
+
+template <typename InputIterator, typename OutputIterator>
+inline OutputIterator adjacent_difference(InputIterator first,
+                                          InputIterator last,
+                                          OutputIterator result) {
+    return __adjacent_difference(first, last, result, value_type(first));
+}
+
+#endif
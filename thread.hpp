@@ -0,0 +1,131 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <cstddef>
+#include <new>
+#if defined(_REENTRANT) || defined(_PTHREADS)
+#define __STL_PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "iterator.hpp"
+
+// Threads are used only when compiling with -pthread (or defining _PTHREADS);
+// otherwise every helper below runs its tasks on the calling thread.
+// Tasks run on worker threads must not throw.
+
+inline std::size_t __thread_count() {
+#ifdef __STL_PTHREADS
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 1) return n > 64 ? 64 : std::size_t(n);
+#endif
+    return 1;
+}
+
+class __mutex {
+protected:
+#ifdef __STL_PTHREADS
+    pthread_mutex_t mutex;
+#endif
+    __mutex(const __mutex&);
+    void operator=(const __mutex&);
+public:
+#ifdef __STL_PTHREADS
+    __mutex() { pthread_mutex_init(&mutex, 0); }
+    ~__mutex() { pthread_mutex_destroy(&mutex); }
+    void lock() { pthread_mutex_lock(&mutex); }
+    void unlock() { pthread_mutex_unlock(&mutex); }
+#else
+    __mutex() {}
+    void lock() {}
+    void unlock() {}
+#endif
+};
+
+class __lock {
+protected:
+    __mutex& mutex;
+    __lock(const __lock&);
+    void operator=(const __lock&);
+public:
+    __lock(__mutex& m): mutex(m) { mutex.lock(); }
+    ~__lock() { mutex.unlock(); }
+};
+
+template <typename Task>
+void* __run_task(void* task) {
+    (*(Task*)task)();
+    return 0;
+}
+
+template <typename Task>
+class __task_group {
+protected:
+    Task* tasks;
+    std::size_t count;
+    std::size_t capacity;
+    __task_group(const __task_group<Task>&);
+    void operator=(const __task_group<Task>&);
+public:
+    __task_group(std::size_t n):
+        tasks((Task*)::operator new(n * sizeof(Task))), count(0),
+        capacity(n) {}
+    ~__task_group() {
+        for (std::size_t i = 0; i < count; ++i) destroy(tasks + i);
+        ::operator delete(tasks);
+    }
+    std::size_t size() const { return count; }
+    Task& operator[](std::size_t i) { return tasks[i]; }
+    void push(const Task& task) { construct(tasks + count++, task); }
+    void run() {
+#ifdef __STL_PTHREADS
+        if (count > 1) {
+            pthread_t* threads = new pthread_t[count];
+            int* started = new int[count];
+            for (std::size_t i = 1; i < count; ++i)
+                started[i] = pthread_create(threads + i, 0, __run_task<Task>,
+                                            tasks + i) == 0;
+            tasks[0]();
+            for (std::size_t i = 1; i < count; ++i)
+                if (started[i]) pthread_join(threads[i], 0);
+                else tasks[i]();
+            delete[] started;
+            delete[] threads;
+            return;
+        }
+#endif
+        for (std::size_t i = 0; i < count; ++i) tasks[i]();
+    }
+};
+
+template <typename Task>
+class __async {
+protected:
+    Task* task;
+#ifdef __STL_PTHREADS
+    pthread_t thread;
+#endif
+    __async(const __async<Task>&);
+    void operator=(const __async<Task>&);
+public:
+    __async(): task(0) {}
+    ~__async() { wait(); }
+    void start(Task* t) {
+        wait();
+#ifdef __STL_PTHREADS
+        if (pthread_create(&thread, 0, __run_task<Task>, t) == 0) {
+            task = t;
+            return;
+        }
+#endif
+        (*t)();
+    }
+    void wait() {
+#ifdef __STL_PTHREADS
+        if (task) pthread_join(thread, 0);
+#endif
+        task = 0;
+    }
+};
+
+#endif